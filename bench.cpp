@@ -0,0 +1,244 @@
+// Bench: g++ -std=c++14 -O2 bench.cpp -lbenchmark -lpthread && ./a.out --benchmark_out=bench_output.txt --benchmark_out_format=json
+
+#include "game.h"
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+// Every heap allocation made by the process is counted, so each benchmark can
+// report allocations per iteration alongside ns/op. The hooks stay out of line
+// so GCC does not pair the inlined malloc/free with new/delete expressions.
+static size_t allocationCount = 0;
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    ++allocationCount;
+    if (void* ptr = malloc(size ? size : 1))
+        return ptr;
+    throw bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+class AllocationCounter {
+public:
+    AllocationCounter(benchmark::State& state) : state(state), start(allocationCount) {}
+    ~AllocationCounter() {
+        state.counters["allocs/op"] = benchmark::Counter(double(allocationCount - start), benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State& state;
+    size_t start;
+};
+
+// Discards everything written to it, so rendering cost excludes the terminal.
+// Flushes are free here; the *ToFile variants below include their writes.
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+    streamsize xsputn(const char*, streamsize n) override {
+        return n;
+    }
+};
+
+enum Position {
+    POSITION_OPENING,
+    POSITION_MIDGAME,
+    POSITION_KING_JUMPS
+};
+
+// Curated positions: the initial board, the crowded midgame from the
+// ThreeTurnsEach test, and the king multi-jump board from AdvancedPaths
+Board makeBoard(Position position) {
+    Board board;
+    if (position == POSITION_MIDGAME) {
+        board.executePath({{5,2},{4,3}});
+        board.executePath({{2,5},{3,4}});
+        board.executePath({{4,3},{2,5}});
+        board.executePath({{1,4},{3,6}});
+        board.executePath({{5,4},{4,5}});
+        board.executePath({{3,6},{5,4}});
+        board.executePath({{6,3},{4,5}});
+        board.executePath({{2,7},{3,6}});
+        board.executePath({{2,1},{3,0}});
+        board.executePath({{7,4},{6,3}});
+        board.executePath({{0,5},{1,4}});
+    } else if (position == POSITION_KING_JUMPS) {
+        Piece pieces[BOARD_SIZE][BOARD_SIZE];
+        pieces[0][5] = Piece(RED);
+        pieces[0][5].setKing();
+        pieces[1][4] = Piece(WHITE);
+        pieces[1][6] = Piece(WHITE);
+        pieces[3][2] = Piece(WHITE);
+        pieces[3][4] = Piece(WHITE);
+        pieces[3][6] = Piece(WHITE);
+        pieces[5][4] = Piece(WHITE);
+        pieces[5][2] = Piece(WHITE);
+        pieces[5][6] = Piece(WHITE);
+        board = Board(pieces);
+    }
+    return board;
+}
+
+// Location of the piece whose paths each position exercises
+string pathLocation(Position position) {
+    switch (position) {
+        case POSITION_MIDGAME: return "E6";
+        case POSITION_KING_JUMPS: return "A6";
+        default: return "F3";
+    }
+}
+
+static void BM_GeneratePaths(benchmark::State& state) {
+    Position position = Position(state.range(0));
+    Board board = makeBoard(position);
+    string location = pathLocation(position);
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        auto paths = board.generatePaths(location);
+        benchmark::DoNotOptimize(paths);
+    }
+}
+BENCHMARK(BM_GeneratePaths)->Arg(POSITION_OPENING)->Arg(POSITION_MIDGAME)->Arg(POSITION_KING_JUMPS);
+
+static void BM_GenerateAllPaths(benchmark::State& state) {
+    Board board = makeBoard(Position(state.range(0)));
+    vector<string> locations;
+    for (int i = 0; i < BOARD_SIZE; ++i)
+        for (int j = 0; j < BOARD_SIZE; ++j)
+            locations.push_back(board.getLocationFromIndex(make_pair(i,j)));
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        for (const string& location : locations) {
+            auto paths = board.generatePaths(location);
+            benchmark::DoNotOptimize(paths);
+        }
+    }
+}
+BENCHMARK(BM_GenerateAllPaths)->Arg(POSITION_OPENING)->Arg(POSITION_MIDGAME)->Arg(POSITION_KING_JUMPS);
+
+static void BM_ExecutePath(benchmark::State& state) {
+    Position position = Position(state.range(0));
+    Board initial = makeBoard(position);
+    auto paths = initial.generatePaths(pathLocation(position));
+    // The longest path available is the most expensive to execute
+    auto path = *max_element(paths.begin(), paths.end(), [](const vector<pair<int,int>>& a, const vector<pair<int,int>>& b) {
+        return a.size() < b.size();
+    });
+    // Captures can't be undone in place, so each iteration starts from a copy;
+    // subtract BM_CopyBoard for the cost of executePath alone
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        Board board = initial;
+        board.executePath(path);
+        benchmark::DoNotOptimize(board);
+    }
+}
+BENCHMARK(BM_ExecutePath)->Arg(POSITION_OPENING)->Arg(POSITION_MIDGAME)->Arg(POSITION_KING_JUMPS);
+
+static void BM_CopyBoard(benchmark::State& state) {
+    Board initial = makeBoard(Position(state.range(0)));
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        Board board = initial;
+        benchmark::DoNotOptimize(board);
+    }
+}
+BENCHMARK(BM_CopyBoard)->Arg(POSITION_OPENING)->Arg(POSITION_MIDGAME)->Arg(POSITION_KING_JUMPS);
+
+static void BM_NumPieces(benchmark::State& state) {
+    Board board = makeBoard(POSITION_MIDGAME);
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(board.numPieces(RED));
+        benchmark::DoNotOptimize(board.numPieces(WHITE));
+    }
+}
+BENCHMARK(BM_NumPieces);
+
+static void BM_IsValidMove(benchmark::State& state) {
+    Board board = makeBoard(POSITION_KING_JUMPS);
+    Piece king = board.getPiece(0,5);
+    vector<pair<int,int>> curPath = {{0,5},{2,3},{4,5}};
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(board.isValidMove(curPath.back(),6,7,king,curPath));
+        benchmark::DoNotOptimize(board.isValidMove(curPath.back(),2,7,king,curPath));
+        benchmark::DoNotOptimize(board.isValidMove(curPath.back(),2,3,king,curPath));
+        benchmark::DoNotOptimize(board.isValidMove(curPath.back(),6,3,king,curPath));
+    }
+}
+BENCHMARK(BM_IsValidMove);
+
+static void BM_LocationConversion(benchmark::State& state) {
+    Board board;
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        for (int i = 0; i < BOARD_SIZE; ++i) {
+            for (int j = 0; j < BOARD_SIZE; ++j) {
+                string location = board.getLocationFromIndex(make_pair(i,j));
+                benchmark::DoNotOptimize(board.getIndexFromLocation(location));
+            }
+        }
+    }
+}
+BENCHMARK(BM_LocationConversion);
+
+static void BM_RenderBoard(benchmark::State& state) {
+    Board board = makeBoard(POSITION_MIDGAME);
+    NullBuffer buffer;
+    ostream output(&buffer);
+    AllocationCounter counter(state);
+    for (auto _ : state)
+        output << board;
+}
+BENCHMARK(BM_RenderBoard);
+
+static void BM_RenderBoardToFile(benchmark::State& state) {
+    Board board = makeBoard(POSITION_MIDGAME);
+    ofstream output("/dev/null");
+    AllocationCounter counter(state);
+    for (auto _ : state)
+        output << board;
+}
+BENCHMARK(BM_RenderBoardToFile);
+
+static void BM_PrintBoardPaths(benchmark::State& state) {
+    Position position = Position(state.range(0));
+    Board board = makeBoard(position);
+    auto paths = board.generatePaths(pathLocation(position));
+    NullBuffer buffer;
+    streambuf* original = cout.rdbuf(&buffer);
+    {
+        AllocationCounter counter(state);
+        for (auto _ : state)
+            board.printBoardPaths(paths);
+    }
+    cout.rdbuf(original);
+}
+BENCHMARK(BM_PrintBoardPaths)->Arg(POSITION_OPENING)->Arg(POSITION_MIDGAME)->Arg(POSITION_KING_JUMPS);
+
+static void BM_PrintBoardPathsToFile(benchmark::State& state) {
+    Position position = Position(state.range(0));
+    Board board = makeBoard(position);
+    auto paths = board.generatePaths(pathLocation(position));
+    ofstream output("/dev/null");
+    streambuf* original = cout.rdbuf(output.rdbuf());
+    {
+        AllocationCounter counter(state);
+        for (auto _ : state)
+            board.printBoardPaths(paths);
+    }
+    cout.rdbuf(original);
+}
+BENCHMARK(BM_PrintBoardPathsToFile)->Arg(POSITION_OPENING)->Arg(POSITION_MIDGAME)->Arg(POSITION_KING_JUMPS);
+
+BENCHMARK_MAIN();
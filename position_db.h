@@ -0,0 +1,357 @@
+#ifndef POSITION_DB_H
+#define POSITION_DB_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "board.h"
+
+using namespace std;
+
+const int PLAYABLE_SQUARES = BOARD_SIZE*BOARD_SIZE/2;
+const uint32_t POSITION_DB_MAGIC = 0x42444b43; // "CKDB"
+const uint32_t POSITION_DB_VERSION = 1;
+const uint32_t POSITION_DB_DEFAULT_STRIDE = 64;
+
+// A position packed into 12 bytes, one bit per playable square in each word.
+// Square k is row k/4 of the board, on the k%4'th dark square of that row.
+// Positions are always stored with RED to move; see canonicalize().
+struct PackedPosition {
+    uint32_t red;
+    uint32_t white;
+    uint32_t kings;
+
+    // Ordered by (red, white, kings), so every king assignment of a given
+    // piece layout forms one contiguous range.
+    bool operator<(const PackedPosition& other) const {
+        if (red != other.red) return red < other.red;
+        if (white != other.white) return white < other.white;
+        return kings < other.kings;
+    }
+    bool operator==(const PackedPosition& other) const {
+        return red == other.red && white == other.white && kings == other.kings;
+    }
+    bool operator!=(const PackedPosition& other) const {
+        return !(*this == other);
+    }
+};
+static_assert(sizeof(PackedPosition) == 12, "PackedPosition must stay 12 bytes on disk");
+
+// Evaluation and game results, relative to the side to move
+struct PositionStats {
+    int32_t evaluation;
+    uint32_t wins;
+    uint32_t losses;
+    uint32_t draws;
+};
+static_assert(sizeof(PositionStats) == 16, "PositionStats must stay 16 bytes on disk");
+
+struct PositionEntry {
+    PackedPosition position;
+    PositionStats stats;
+    bool hasStats;
+};
+
+// Set in PositionDatabaseHeader::flags when a stats array follows the keys
+const uint32_t POSITION_DB_HAS_STATS = 1;
+
+// File layout: header, sparse index of every indexStride'th key, the sorted
+// keys, then (only with POSITION_DB_HAS_STATS) one PositionStats per key. A
+// key-only database costs 12 bytes per position.
+struct PositionDatabaseHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t indexStride;
+    uint32_t flags;
+    uint64_t count;
+    uint64_t indexCount;
+};
+static_assert(sizeof(PositionDatabaseHeader) == 32, "PositionDatabaseHeader must stay 32 bytes on disk");
+
+inline uint32_t reverseBits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+    x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+    x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Rotating the board 180 degrees maps square k to 31-k. Rotating and swapping
+// colors gives the same position seen from the other player's side.
+inline PackedPosition flipPosition(const PackedPosition& position) {
+    PackedPosition flipped;
+    flipped.red = reverseBits(position.white);
+    flipped.white = reverseBits(position.red);
+    flipped.kings = reverseBits(position.kings);
+    return flipped;
+}
+
+inline PackedPosition canonicalize(const PackedPosition& position, Color toMove) {
+    return (toMove == WHITE) ? flipPosition(position) : position;
+}
+
+inline PackedPosition packBoard(const Board& board, Color toMove) {
+    PackedPosition position = {0, 0, 0};
+    for (int k = 0; k < PLAYABLE_SQUARES; ++k) {
+        int row = k/4;
+        int col = 2*(k%4) + (row+1)%2;
+        Piece piece = board.getPiece(row,col);
+        uint32_t bit = uint32_t(1) << k;
+        if (piece.getColor() == RED)
+            position.red |= bit;
+        else if (piece.getColor() == WHITE)
+            position.white |= bit;
+        if (piece.getColor() != NONE && piece.isKing())
+            position.kings |= bit;
+    }
+    return canonicalize(position, toMove);
+}
+
+// Rebuilds the canonical board, which always has RED to move
+inline Board unpackBoard(const PackedPosition& position) {
+    Piece pieces[BOARD_SIZE][BOARD_SIZE];
+    for (int k = 0; k < PLAYABLE_SQUARES; ++k) {
+        int row = k/4;
+        int col = 2*(k%4) + (row+1)%2;
+        uint32_t bit = uint32_t(1) << k;
+        if (position.red & bit)
+            pieces[row][col] = Piece(RED);
+        else if (position.white & bit)
+            pieces[row][col] = Piece(WHITE);
+        if (position.kings & bit)
+            pieces[row][col].setKing();
+    }
+    return Board(pieces);
+}
+
+class PositionDatabaseBuilder {
+public:
+    PositionDatabaseBuilder() : withStats(false) {}
+    void add(const Board& board, Color toMove) {
+        add(packBoard(board, toMove));
+    }
+    void add(const Board& board, Color toMove, const PositionStats& stats) {
+        add(packBoard(board, toMove), stats);
+    }
+    // Packed positions are stored as given, so they must already be
+    // canonicalize()d to RED to move. Positions added without stats carry
+    // zeroed stats if any other position has them; if none do, the database
+    // is written key-only.
+    void add(const PackedPosition& position) {
+        checkPosition(position);
+        entries.push_back({position, {0, 0, 0, 0}, false});
+    }
+    void add(const PackedPosition& position, const PositionStats& stats) {
+        checkPosition(position);
+        entries.push_back({position, stats, true});
+        withStats = true;
+    }
+    size_t size() const {
+        return entries.size();
+    }
+    // Sorts and deduplicates the entries, then writes them behind a sparse
+    // index holding the key of every indexStride'th entry. Results of
+    // duplicates are summed and the last evaluation supplied with stats wins.
+    void write(const string& path, uint32_t indexStride = POSITION_DB_DEFAULT_STRIDE) {
+        if (indexStride == 0)
+            throw(invalid_argument("Position database index stride must be positive"));
+
+        stable_sort(entries.begin(), entries.end(), [](const PositionEntry& a, const PositionEntry& b) {
+            return a.position < b.position;
+        });
+        vector<PositionEntry> unique;
+        unique.reserve(entries.size());
+        for (const PositionEntry& entry : entries) {
+            if (!unique.empty() && unique.back().position == entry.position) {
+                PositionStats& merged = unique.back().stats;
+                if (entry.hasStats) {
+                    merged.evaluation = entry.stats.evaluation;
+                    unique.back().hasStats = true;
+                }
+                merged.wins += entry.stats.wins;
+                merged.losses += entry.stats.losses;
+                merged.draws += entry.stats.draws;
+            } else {
+                unique.push_back(entry);
+            }
+        }
+        entries.swap(unique);
+
+        vector<PackedPosition> index;
+        vector<PackedPosition> keys;
+        vector<PositionStats> stats;
+        keys.reserve(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (i % indexStride == 0)
+                index.push_back(entries[i].position);
+            keys.push_back(entries[i].position);
+            if (withStats)
+                stats.push_back(entries[i].stats);
+        }
+
+        PositionDatabaseHeader header = {
+            POSITION_DB_MAGIC, POSITION_DB_VERSION, indexStride,
+            withStats ? POSITION_DB_HAS_STATS : 0, keys.size(), index.size()
+        };
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file)
+            throw(runtime_error("Unable to open position database for writing: " + path));
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        if (ok && !index.empty())
+            ok = fwrite(index.data(), sizeof(PackedPosition), index.size(), file) == index.size();
+        if (ok && !keys.empty())
+            ok = fwrite(keys.data(), sizeof(PackedPosition), keys.size(), file) == keys.size();
+        if (ok && !stats.empty())
+            ok = fwrite(stats.data(), sizeof(PositionStats), stats.size(), file) == stats.size();
+        if (fclose(file) != 0)
+            ok = false;
+        if (!ok)
+            throw(runtime_error("Unable to write position database: " + path));
+    }
+
+private:
+    static void checkPosition(const PackedPosition& position) {
+        if (position.red & position.white)
+            throw(invalid_argument("Packed position has a square that is both red and white"));
+        if (position.kings & ~(position.red | position.white))
+            throw(invalid_argument("Packed position has a king on an empty square"));
+    }
+
+    vector<PositionEntry> entries;
+    bool withStats;
+};
+
+// Read-only view of a database written by PositionDatabaseBuilder. The file is
+// mapped into memory, so it must come from a machine with the same byte order.
+class PositionDatabase {
+public:
+    PositionDatabase(const string& path) : data(nullptr), length(0), header(nullptr), index(nullptr), keys(nullptr), stats(nullptr) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw(runtime_error("Unable to open position database: " + path));
+        struct stat info;
+        if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(PositionDatabaseHeader)) {
+            close(fd);
+            throw(runtime_error("Position database is truncated: " + path));
+        }
+        length = info.st_size;
+        data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            throw(runtime_error("Unable to map position database: " + path));
+
+        header = static_cast<const PositionDatabaseHeader*>(data);
+        if (!validHeader()) {
+            munmap(data, length);
+            throw(runtime_error("Invalid position database: " + path));
+        }
+        const char* base = static_cast<const char*>(data);
+        index = reinterpret_cast<const PackedPosition*>(base + sizeof(PositionDatabaseHeader));
+        keys = index + header->indexCount;
+        if (hasStats())
+            stats = reinterpret_cast<const PositionStats*>(keys + header->count);
+    }
+    PositionDatabase(const PositionDatabase&) = delete;
+    PositionDatabase& operator=(const PositionDatabase&) = delete;
+    ~PositionDatabase() {
+        munmap(data, length);
+    }
+    size_t size() const {
+        return header->count;
+    }
+    bool hasStats() const {
+        return (header->flags & POSITION_DB_HAS_STATS) != 0;
+    }
+    bool contains(const Board& board, Color toMove) const {
+        return contains(packBoard(board, toMove));
+    }
+    bool contains(const PackedPosition& position) const {
+        const PackedPosition* it = lowerBound(position);
+        return it != end() && *it == position;
+    }
+    // Returns nullptr if the position is absent or the database is key-only
+    const PositionStats* find(const Board& board, Color toMove) const {
+        return find(packBoard(board, toMove));
+    }
+    const PositionStats* find(const PackedPosition& position) const {
+        const PackedPosition* it = lowerBound(position);
+        if (it == end() || *it != position)
+            return nullptr;
+        return statsFor(it);
+    }
+    // All keys with first <= position <= last, as a [begin,end) pair
+    pair<const PackedPosition*,const PackedPosition*> range(const PackedPosition& first, const PackedPosition& last) const {
+        const PackedPosition* lo = lowerBound(first);
+        const PackedPosition* hi = upperBound(last);
+        return make_pair(lo, max(lo, hi));
+    }
+    // Stats stored alongside a key in [begin(),end()), or nullptr if key-only
+    const PositionStats* statsFor(const PackedPosition* key) const {
+        return stats ? stats + (key - keys) : nullptr;
+    }
+    const PackedPosition* begin() const {
+        return keys;
+    }
+    const PackedPosition* end() const {
+        return keys + header->count;
+    }
+
+private:
+    // The header must describe exactly the file's contents, with one index key
+    // per indexStride entries, so block() can never leave the mapping
+    bool validHeader() const {
+        if (header->magic != POSITION_DB_MAGIC || header->version != POSITION_DB_VERSION)
+            return false;
+        if (header->indexStride == 0 || (header->flags & ~POSITION_DB_HAS_STATS) != 0)
+            return false;
+        uint64_t stride = header->indexStride;
+        uint64_t expectedIndex = header->count/stride + (header->count%stride != 0);
+        if (header->indexCount != expectedIndex)
+            return false;
+
+        uint64_t remaining = length - sizeof(PositionDatabaseHeader);
+        if (header->indexCount > remaining/sizeof(PackedPosition))
+            return false;
+        remaining -= header->indexCount*sizeof(PackedPosition);
+        uint64_t entrySize = sizeof(PackedPosition) + (hasStats() ? sizeof(PositionStats) : 0);
+        if (header->count > remaining/entrySize)
+            return false;
+        return remaining == header->count*entrySize;
+    }
+    // Narrows a search to the keys between the last indexed key <= position
+    // and the next indexed key
+    pair<const PackedPosition*,const PackedPosition*> block(const PackedPosition& position) const {
+        const PackedPosition* next = upper_bound(index, index + header->indexCount, position);
+        size_t nextBlock = next - index;
+        size_t first = (nextBlock == 0) ? 0 : (nextBlock-1)*header->indexStride;
+        size_t last = min<size_t>(nextBlock*header->indexStride, header->count);
+        return make_pair(keys + first, keys + last);
+    }
+    const PackedPosition* lowerBound(const PackedPosition& position) const {
+        auto bounds = block(position);
+        return lower_bound(bounds.first, bounds.second, position);
+    }
+    const PackedPosition* upperBound(const PackedPosition& position) const {
+        auto bounds = block(position);
+        return upper_bound(bounds.first, bounds.second, position);
+    }
+
+    void* data;
+    size_t length;
+    const PositionDatabaseHeader* header;
+    const PackedPosition* index;
+    const PackedPosition* keys;
+    const PositionStats* stats;
+};
+
+#endif // POSITION_DB_H
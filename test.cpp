@@ -2,6 +2,7 @@
 // Test: g++ -std=c++14 test.cpp -lgtest -lgtest_main -lgmock && ./a.out
 
 #include "game.h"
+#include "position_db.h"
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
@@ -280,6 +281,141 @@ TEST_F(BoardTest, AdvancedPaths) {
     
 }
 
+TEST_F(BoardTest, PackedPositionRoundTrip) {
+    board[0][5] = Piece(RED);
+    board[0][5].setKing();
+    board[2][3] = Piece(WHITE);
+    board[7][0] = Piece(WHITE);
+    board[7][0].setKing();
+    board[5][6] = Piece(RED);
+
+    Board test_board(board);
+    Board unpacked = unpackBoard(packBoard(test_board, RED));
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            EXPECT_EQ(unpacked.getPiece(i,j).getColor(), test_board.getPiece(i,j).getColor());
+            if (test_board.getPiece(i,j).getColor() != NONE) {
+                EXPECT_EQ(unpacked.getPiece(i,j).isKing(), test_board.getPiece(i,j).isKing());
+            }
+        }
+    }
+}
+
+TEST_F(BoardTest, PackedPositionSymmetry) {
+    // The same position seen from the other side, with the other player to move
+    board[2][3] = Piece(RED);
+    board[6][1] = Piece(WHITE);
+    board[6][1].setKing();
+    Piece flipped[BOARD_SIZE][BOARD_SIZE];
+    flipped[5][4] = Piece(WHITE);
+    flipped[1][6] = Piece(RED);
+    flipped[1][6].setKing();
+
+    Board test_board(board);
+    Board flipped_board(flipped);
+    EXPECT_EQ(packBoard(test_board, RED), packBoard(flipped_board, WHITE));
+    EXPECT_NE(packBoard(test_board, RED), packBoard(test_board, WHITE));
+}
+
+class PositionDatabaseTest : public testing::Test {
+protected:
+    void SetUp() override {
+        char name[] = "/tmp/checkers_positions_XXXXXX";
+        int fd = mkstemp(name);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        path = name;
+    }
+    void TearDown() override {
+        if (!path.empty())
+            remove(path.c_str());
+    }
+    string path;
+};
+
+TEST_F(PositionDatabaseTest, DeduplicatedLookups) {
+    Board board;
+    Board moved;
+    moved.executePath({{5,2},{4,3}});
+
+    PositionDatabaseBuilder builder;
+    builder.add(board, RED, {10, 1, 0, 0});
+    builder.add(moved, WHITE, {-5, 0, 1, 0});
+    builder.add(board, RED, {12, 0, 0, 1});
+    builder.add(board, RED);
+    builder.add(moved, WHITE);
+    for (uint32_t i = 1; i <= 200; ++i)
+        builder.add({i, i << 8, 0}, {int32_t(i), 0, 0, 0});
+    builder.write(path, 16);
+
+    PositionDatabase db(path);
+    EXPECT_EQ(db.size(), 202);
+    EXPECT_TRUE(db.hasStats());
+
+    const PositionStats* stats = db.find(board, RED);
+    ASSERT_NE(stats, nullptr);
+    EXPECT_EQ(stats->evaluation, 12);
+    EXPECT_EQ(stats->wins, 1);
+    EXPECT_EQ(stats->draws, 1);
+
+    stats = db.find(moved, WHITE);
+    ASSERT_NE(stats, nullptr);
+    EXPECT_EQ(stats->evaluation, -5);
+    EXPECT_EQ(db.find(moved, RED), nullptr);
+
+    for (uint32_t i = 1; i <= 200; ++i) {
+        stats = db.find({i, i << 8, 0});
+        ASSERT_NE(stats, nullptr);
+        EXPECT_EQ(stats->evaluation, int32_t(i));
+    }
+
+    auto range = db.range({50, 0, 0}, {59, 0xFFFFFFFF, 0xFFFFFFFF});
+    ASSERT_EQ(range.second - range.first, 10);
+    EXPECT_EQ(range.first->red, 50);
+    EXPECT_EQ((range.second-1)->red, 59);
+    EXPECT_EQ(db.statsFor(range.first)->evaluation, 50);
+}
+
+TEST_F(PositionDatabaseTest, RejectsMalformedKeys) {
+    PositionDatabaseBuilder builder;
+    EXPECT_THROW(builder.add({1, 1, 0}), invalid_argument);
+    EXPECT_THROW(builder.add({1, 0, 2}, {0, 0, 0, 0}), invalid_argument);
+    EXPECT_NO_THROW(builder.add({1, 2, 3}));
+}
+
+TEST_F(PositionDatabaseTest, KeyOnlyEntries) {
+    PositionDatabaseBuilder builder;
+    for (uint32_t i = 1; i <= 100; ++i) {
+        builder.add({i, 0, 0});
+        builder.add({i, 0, 0});
+    }
+    builder.write(path, 16);
+
+    PositionDatabase db(path);
+    EXPECT_EQ(db.size(), 100);
+    EXPECT_FALSE(db.hasStats());
+    EXPECT_TRUE(db.contains({42, 0, 0}));
+    EXPECT_FALSE(db.contains({101, 0, 0}));
+    EXPECT_EQ(db.find({42, 0, 0}), nullptr);
+
+    struct stat info;
+    ASSERT_EQ(stat(path.c_str(), &info), 0);
+    EXPECT_EQ(size_t(info.st_size), sizeof(PositionDatabaseHeader) + (7+100)*sizeof(PackedPosition));
+}
+
+TEST_F(PositionDatabaseTest, RejectsMismatchedIndex) {
+    // Sizes add up, but one index key is claimed for every entry
+    PositionDatabaseHeader header = {POSITION_DB_MAGIC, POSITION_DB_VERSION, 4, 0, 4, 4};
+    PackedPosition keys[8] = {};
+    FILE* file = fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(keys, sizeof(PackedPosition), 8, file);
+    fclose(file);
+
+    EXPECT_THROW(PositionDatabase db(path), runtime_error);
+}
+
 int main() {
     testing::InitGoogleTest();
     return RUN_ALL_TESTS();